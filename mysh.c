@@ -1,3 +1,6 @@
+// kill() is only declared by signal.h with POSIX features enabled under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -9,19 +12,34 @@
 #include <dirent.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <utime.h>
+#include <signal.h>
 
 #define MAX_COMMAND_LENGTH 10000
 #define MAX_TOKENS 1000
 #define MAX_TOKEN_LENGTH 1000
 #define BUFLENGTH 16
 
-// Directory paths to search for executables
-#define DIR_PATHS {"/usr/local/bin", "/usr/bin", "/bin"}
+// Directory paths to search for executables (NULL terminated)
+#define DIR_PATHS {"/usr/local/bin", "/usr/bin", "/bin", NULL}
+
+// Names of the built-in commands (NULL terminated)
+#define BUILTINS {"cd", "pwd", "which", "exit", "memo", NULL}
+
+// Default cache directory for memo (relative to $HOME) and its size bound in bytes
+#define MEMO_DIR_NAME ".mysh_memo"
+#define MEMO_MAX_BYTES (64L * 1024 * 1024)
 
 // Global int variable that keeps track of if the previous command failed or succeeded
 //Used for conditionals
 int currstatus = 1;
 
+// Hit/miss/eviction counters for the memo builtin, reported by "memo -s"
+// A memo pipeline stage runs in a forked child, so its counts don't reach these
+long memo_hits = 0;
+long memo_misses = 0;
+long memo_evictions = 0;
+
 typedef struct {
     int fd;
     int pos;
@@ -29,6 +47,13 @@ typedef struct {
     char buf[BUFLENGTH];
 } lines_t;
 
+// A finished memo cache entry, used to pick entries to evict
+typedef struct {
+    time_t mtime;
+    off_t size;
+    char name[64];
+} memo_entry_t;
+
 // Function prototypes
 void print_prompt();
 void fdinit(lines_t *L, int fd);
@@ -40,10 +65,16 @@ void execute_builtin_command(char* tokens[]);
 void print_welcome_message();
 void print_goodbye_message();
 int check_slash(char* command);
+int is_builtin(char* command);
 void check_redirection(char* tokens[]);
 void execute_full(char* tokens[]);
 int check_pipe(char* tokens[]);
+int check_output_redirection(char* tokens[]);
 void preprocess_command(char* command);
+void execute_memo(char* tokens[]);
+int find_command(char* command, char* path);
+void exec_stage(char* tokens[]);
+void give_terminal(pid_t pgid);
 
 
 int main(int argc, char* argv[]) {
@@ -234,6 +265,20 @@ int check_slash(char* command) {
     return state;
 }
 
+//checks if the command is one of the built-in commands
+//returns 1 if it is
+int is_builtin(char* command) {
+    char* builtins[] = BUILTINS;
+    int i = 0;
+    while (builtins[i] != NULL) {
+        if (strcmp(command, builtins[i]) == 0) {
+            return 1;
+        }
+        i++;
+    }
+    return 0;
+}
+
 //executes each single command based each special case
 void execute_command(char* tokens[]) {
     // Save STDIN and STDOUT to handle redirection cases
@@ -256,9 +301,10 @@ void execute_command(char* tokens[]) {
         }
         tokens = &tokens[1];
     }
-    //if built-in command
-    if (strcmp(tokens[0], "cd") == 0 || strcmp(tokens[0], "pwd") == 0 || 
-        strcmp(tokens[0], "which") == 0 || strcmp(tokens[0], "exit") == 0) {
+    //memo handles its own redirection, so it must run before check_redirection
+    if (strcmp(tokens[0], "memo") == 0) {
+        execute_memo(tokens);
+    } else if (is_builtin(tokens[0])) {
         check_redirection(tokens);
         execute_builtin_command(tokens);
     } else if (check_slash(tokens[0]) == 0) {
@@ -280,6 +326,7 @@ void execute_command(char* tokens[]) {
                 pid_t pid = fork();
                 if (pid == 0) {
                     // Child process
+                    signal(SIGPIPE, SIG_DFL);
                     check_redirection(tokens);
                     execv(path, tokens);
                     // error if execv returns
@@ -309,6 +356,7 @@ void execute_command(char* tokens[]) {
         pid_t pid = fork();
         if (pid == 0) {
             // Child process
+            signal(SIGPIPE, SIG_DFL);
             check_redirection(tokens);
             execv(tokens[0], tokens);
             // error if execv returns
@@ -480,8 +528,7 @@ void execute_builtin_command(char* tokens[]) {
             currstatus = 0;
         }
     } else if (strcmp(tokens[0], "which") == 0) {
-        if ((tokens[1] == NULL) || (tokens[2] != NULL) || (strcmp(tokens[1], "cd") == 0 || strcmp(tokens[1], "pwd") == 0 ||
-        strcmp(tokens[1], "which") == 0 || strcmp(tokens[1], "exit") == 0)) {
+        if ((tokens[1] == NULL) || (tokens[2] != NULL) || is_builtin(tokens[1])) {
             fprintf(stderr, "which: incorrect arguments\n");
             currstatus = 0;
         } else {
@@ -524,6 +571,325 @@ void execute_builtin_command(char* tokens[]) {
  
 }
 
+//FNV-1a hash used to build memo cache keys
+unsigned long long memo_hash_bytes(unsigned long long h, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+//hashes a string including its terminator so "ab" "c" and "a" "bc" give different keys
+unsigned long long memo_hash_string(unsigned long long h, const char *str) {
+    return memo_hash_bytes(h, str, strlen(str) + 1);
+}
+
+//hashes the contents of a file, a missing file gets its own marker
+unsigned long long memo_hash_file(unsigned long long h, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return memo_hash_string(h, "missing");
+    }
+    h = memo_hash_string(h, "file");
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        h = memo_hash_bytes(h, buf, n);
+    }
+    close(fd);
+    return h;
+}
+
+//hashes the size and mtime of the executable the command resolves to
+//so rebuilding a program (like ./test) invalidates its cached output
+unsigned long long memo_hash_executable(unsigned long long h, const char *command) {
+    char path[MAX_COMMAND_LENGTH];
+    //built-in commands have no executable to hash
+    if (!find_command((char *) command, path)) {
+        return h;
+    }
+
+    struct stat sbuf;
+    if (stat(path, &sbuf) == 0) {
+        h = memo_hash_bytes(h, (char *) &sbuf.st_size, sizeof(sbuf.st_size));
+        h = memo_hash_bytes(h, (char *) &sbuf.st_mtime, sizeof(sbuf.st_mtime));
+    }
+    return h;
+}
+
+//copies everything from one fd into another, returns -1 on failure
+int memo_copy_fd(int from, int to) {
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(from, buf, sizeof(buf))) > 0) {
+        if (write(to, buf, n) != n) {
+            return -1;
+        }
+    }
+    return n < 0 ? -1 : 0;
+}
+
+//orders cache entries from least to most recently used
+int memo_compare_entries(const void *a, const void *b) {
+    const memo_entry_t *x = a;
+    const memo_entry_t *y = b;
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+//evicts the least recently used cache entries until the cache fits in MEMO_MAX_BYTES
+//the number of entries and bytes left are stored in count and total if they aren't NULL
+void memo_evict(const char *dir, int *count, long long *total) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        return;
+    }
+
+    memo_entry_t *entries = NULL;
+    int entry_count = 0;
+    int capacity = 0;
+    long long bytes = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d))) {
+        if (ent->d_name[0] == '.' || strlen(ent->d_name) >= sizeof(entries[0].name)) {
+            continue;
+        }
+        char path[MAX_COMMAND_LENGTH];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+
+        //temp files are named <key>.<pid>.tmp, skip the ones still being written and
+        //remove the ones left behind by a process that died before committing its entry
+        if (strstr(ent->d_name, ".tmp") != NULL) {
+            char *pid_start = strchr(ent->d_name, '.');
+            pid_t pid = atoi(pid_start + 1);
+            if (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH) {
+                unlink(path);
+            }
+            continue;
+        }
+        struct stat sbuf;
+        if (stat(path, &sbuf) < 0 || !S_ISREG(sbuf.st_mode)) {
+            continue;
+        }
+        if (entry_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            entries = realloc(entries, capacity * sizeof(memo_entry_t));
+        }
+        entries[entry_count].mtime = sbuf.st_mtime;
+        entries[entry_count].size = sbuf.st_size;
+        strcpy(entries[entry_count].name, ent->d_name);
+        entry_count++;
+        bytes += sbuf.st_size;
+    }
+    closedir(d);
+
+    qsort(entries, entry_count, sizeof(memo_entry_t), memo_compare_entries);
+    int i = 0;
+    while (i < entry_count && bytes > MEMO_MAX_BYTES) {
+        char path[MAX_COMMAND_LENGTH];
+        snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+        if (unlink(path) == 0) {
+            bytes -= entries[i].size;
+            memo_evictions++;
+        }
+        i++;
+    }
+    free(entries);
+
+    if (count != NULL) {
+        *count = entry_count - i;
+    }
+    if (total != NULL) {
+        *total = bytes;
+    }
+}
+
+//memo [-s] [-i file]... [-e var]... command [args] [< input] [> output]
+//caches the output of command under a key built from its arguments, the contents of its
+//< input and -i files, its executable, the working directory, PATH and any -e variables
+//a later run with the same key replays the cached output instead of running command again
+void execute_memo(char* tokens[]) {
+    // Cache lives in $MYSH_MEMO_DIR, or ~/.mysh_memo by default
+    char dir[MAX_TOKEN_LENGTH];
+    char *memo_dir = getenv("MYSH_MEMO_DIR");
+    if (memo_dir != NULL) {
+        snprintf(dir, sizeof(dir), "%s", memo_dir);
+    } else {
+        char *home = getenv("HOME");
+        snprintf(dir, sizeof(dir), "%s/%s", home ? home : ".", MEMO_DIR_NAME);
+    }
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        perror("memo");
+        currstatus = 0;
+        return;
+    }
+
+    unsigned long long h = 14695981039346656037ULL;
+
+    // Options come before the command
+    int i = 1;
+    while (tokens[i] != NULL && tokens[i][0] == '-') {
+        if (strcmp(tokens[i], "-s") == 0) {
+            int count = 0;
+            long long total = 0;
+            memo_evict(dir, &count, &total);
+            printf("memo: %ld hits, %ld misses, %ld evictions, %d entries (%lld bytes)\n",
+                   memo_hits, memo_misses, memo_evictions, count, total);
+            currstatus = 1;
+            return;
+        } else if (strcmp(tokens[i], "-i") == 0 && tokens[i + 1] != NULL) {
+            // Declared input file, hashed by content
+            h = memo_hash_string(h, tokens[i + 1]);
+            h = memo_hash_file(h, tokens[i + 1]);
+            i += 2;
+        } else if (strcmp(tokens[i], "-e") == 0 && tokens[i + 1] != NULL) {
+            // Declared environment variable, hashed by name and value
+            char *value = getenv(tokens[i + 1]);
+            h = memo_hash_string(h, tokens[i + 1]);
+            h = memo_hash_string(h, value ? value : "unset");
+            i += 2;
+        } else {
+            fprintf(stderr, "memo: incorrect arguments\n");
+            currstatus = 0;
+            return;
+        }
+    }
+
+    if (tokens[i] == NULL) {
+        fprintf(stderr, "memo: missing command\n");
+        currstatus = 0;
+        return;
+    }
+
+    //memo execs the command itself, so built-ins can't run under it
+    //(a hit would also skip the side effects of cd and exit)
+    if (is_builtin(tokens[i])) {
+        fprintf(stderr, "memo: incorrect arguments\n");
+        currstatus = 0;
+        return;
+    }
+
+    //copy the command without its output redirection, since memo writes the output itself
+    //the output file name is left out of the key so any target can replay the same entry
+    char *cmd[MAX_TOKENS];
+    char *output_file = NULL;
+    int input_redirected = 0;
+    int n = 0;
+    for (int j = i; tokens[j] != NULL; j++) {
+        if (strcmp(tokens[j], ">") == 0 && tokens[j + 1] != NULL) {
+            output_file = tokens[j + 1];
+            j++;
+            continue;
+        }
+        if (strcmp(tokens[j], "<") == 0 && tokens[j + 1] != NULL) {
+            h = memo_hash_file(h, tokens[j + 1]);
+            input_redirected = 1;
+        }
+        h = memo_hash_string(h, tokens[j]);
+        cmd[n] = tokens[j];
+        n++;
+    }
+    cmd[n] = NULL;
+
+    //the command's inputs are its < and -i files, so without a < file it reads /dev/null
+    //instead of the shell's stdin (a pipe or terminal can't be part of the key)
+    if (!input_redirected) {
+        h = memo_hash_string(h, "no stdin");
+    }
+
+    char cwd[1000];
+    if (getcwd(cwd, sizeof(cwd)) != NULL) {
+        h = memo_hash_string(h, cwd);
+    }
+    char *path_env = getenv("PATH");
+    h = memo_hash_string(h, path_env ? path_env : "");
+    h = memo_hash_executable(h, cmd[0]);
+
+    char entry[MAX_COMMAND_LENGTH];
+    char tmp[MAX_COMMAND_LENGTH];
+    snprintf(entry, sizeof(entry), "%s/%016llx", dir, h);
+    snprintf(tmp, sizeof(tmp), "%s/%016llx.%d.tmp", dir, h, (int) getpid());
+
+    int out_fd = STDOUT_FILENO;
+    if (output_file != NULL) {
+        out_fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+        if (out_fd < 0) {
+            perror("open");
+            currstatus = 0;
+            return;
+        }
+    }
+    fflush(stdout);
+
+    int entry_fd = open(entry, O_RDONLY);
+    if (entry_fd >= 0) {
+        // Cache hit, replay the stored output
+        memo_hits++;
+        currstatus = memo_copy_fd(entry_fd, out_fd) == 0;
+        close(entry_fd);
+        //refresh mtime so eviction drops the least recently used entries first
+        utime(entry, NULL);
+    } else {
+        // Cache miss, run the command with its output captured in a temp file
+        memo_misses++;
+        int tmp_fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (tmp_fd < 0) {
+            perror("memo");
+            currstatus = 0;
+        } else {
+            //run the command here rather than through execute_command, which doesn't
+            //report the exit status, so that only runs exiting with 0 are recorded
+            char path[MAX_COMMAND_LENGTH];
+            currstatus = 0;
+            if (!find_command(cmd[0], path)) {
+                printf("Command not found: %s\n", cmd[0]);
+            } else {
+                pid_t pid = fork();
+                if (pid == 0) {
+                    // Child process, output goes to the temp file
+                    //SIGPIPE is inherited from memo, so a memo stage with > keeps ignoring the teardown
+                    dup2(tmp_fd, STDOUT_FILENO);
+                    close(tmp_fd);
+                    if (!input_redirected) {
+                        int null_fd = open("/dev/null", O_RDONLY);
+                        dup2(null_fd, STDIN_FILENO);
+                        close(null_fd);
+                    }
+                    check_redirection(cmd);
+                    execv(path, cmd);
+                    // error if execv returns
+                    perror("execv");
+                    exit(EXIT_FAILURE);
+                } else if (pid < 0) {
+                    // Fork failed
+                    perror("fork");
+                } else {
+                    int status;
+                    waitpid(pid, &status, 0);
+                    currstatus = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                }
+            }
+
+            //commit the entry before replaying it, since a consumer that exits early
+            //(memo sort < input | head -1) kills this stage with SIGPIPE during the copy
+            //tmp_fd still refers to the same file after the rename or unlink
+            if (currstatus == 1 && rename(tmp, entry) == 0) {
+                memo_evict(dir, NULL, NULL);
+            } else {
+                unlink(tmp);
+            }
+
+            lseek(tmp_fd, 0, SEEK_SET);
+            memo_copy_fd(tmp_fd, out_fd);
+            close(tmp_fd);
+        }
+    }
+
+    if (out_fd != STDOUT_FILENO) {
+        close(out_fd);
+    }
+}
+
 //Checks and handles redirection
 void check_redirection(char *tokens[]) {
     int i = 0;
@@ -587,6 +953,86 @@ void check_redirection(char *tokens[]) {
 }
 
 
+//finds the executable for command, either a direct pathname or a bare name in DIR_PATHS
+//stores the full path in path and returns 1 if it was found
+int find_command(char* command, char* path) {
+    if (check_slash(command)) {
+        strcpy(path, command);
+        return 1;
+    }
+    char* dir_paths[] = DIR_PATHS;
+    int i = 0;
+    while (dir_paths[i] != NULL) {
+        strcpy(path, dir_paths[i]);
+        strcat(path, "/");
+        strcat(path, command);
+        if (access(path, X_OK) == 0) {
+            return 1;
+        }
+        i++;
+    }
+    return 0;
+}
+
+//runs one stage of a pipeline inside its forked child and never returns
+//external commands replace the child with execv, so no extra process sits between
+//the pipe and the command waiting on it
+void exec_stage(char* tokens[]) {
+    // Default SIGPIPE so a producer dies as soon as the stage reading from it exits
+    //a stage writing to a > file has no pipe to break, so the only SIGPIPE it can get is the
+    //teardown sent to the group once the last stage exits, which it ignores to finish its file
+    if (check_output_redirection(tokens)) {
+        signal(SIGPIPE, SIG_IGN);
+    } else {
+        signal(SIGPIPE, SIG_DFL);
+    }
+
+    if (tokens[0] == NULL) {
+        fprintf(stderr, "mysh: missing command in pipeline\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Conditionals only apply to the stage they are attached to
+    if (strcmp(tokens[0], "then") == 0) {
+        if (currstatus != 1) {
+            exit(EXIT_SUCCESS);
+        }
+        tokens = &tokens[1];
+    } else if (strcmp(tokens[0], "else") == 0) {
+        if (currstatus != 0) {
+            exit(EXIT_SUCCESS);
+        }
+        tokens = &tokens[1];
+    }
+
+    //built-ins have nothing to exec, so run them here and exit with their status
+    if (is_builtin(tokens[0])) {
+        execute_command(tokens);
+        fflush(stdout);
+        exit(currstatus == 1 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    char path[MAX_COMMAND_LENGTH];
+    if (!find_command(tokens[0], path)) {
+        printf("Command not found: %s\n", tokens[0]);
+        fflush(stdout);
+        exit(EXIT_FAILURE);
+    }
+    check_redirection(tokens);
+    execv(path, tokens);
+    // error if execv returns
+    perror("execv");
+    exit(EXIT_FAILURE);
+}
+
+//makes pgid the foreground process group of the terminal
+//SIGTTOU is ignored while doing so, since a background group calling tcsetpgrp gets stopped by it
+void give_terminal(pid_t pgid) {
+    void (*old_handler)(int) = signal(SIGTTOU, SIG_IGN);
+    tcsetpgrp(STDIN_FILENO, pgid);
+    signal(SIGTTOU, old_handler);
+}
+
 //check if pipe exists in the command
 //returns 1 if it does
 int check_pipe(char* tokens[]) {
@@ -603,6 +1049,21 @@ int check_pipe(char* tokens[]) {
 }
 
 
+//check if the command redirects its output with >
+//returns 1 if it does
+int check_output_redirection(char* tokens[]) {
+    int i = 0;
+    int state = 0;
+    while (tokens[i] != NULL) {
+        if (strcmp(tokens[i], ">") == 0) {
+            state = 1;
+            break;
+        }
+        i++;
+    }
+    return state;
+}
+
 //executes entire command and accounts for piping
 //redirection takes precedence due to its usage in execute_command()
 void execute_full(char* tokens[]) {
@@ -613,68 +1074,128 @@ void execute_full(char* tokens[]) {
     if (check_pipe(tokens) == 0) {
         execute_command(tokens);
     } else {
-        //Traverse the tokens to find where the pipe occurs (used to split up into two processes)
-        int pipe_index = 0;
-        while (tokens[pipe_index] != NULL) {
-            if (strcmp(tokens[pipe_index], "|") == 0) {
-                break;
+        //Split the tokens into stages at each pipe symbol
+        char** stages[MAX_TOKENS];
+        int stage_count = 1;
+        stages[0] = tokens;
+        for (int i = 0; tokens[i] != NULL; i++) {
+            if (strcmp(tokens[i], "|") == 0) {
+                //set pipe token to null so execv stops when it reaches the end of the stage
+                tokens[i] = NULL;
+                stages[stage_count] = &tokens[i + 1];
+                stage_count++;
             }
-            pipe_index++;
         }
 
-        // Create pipe
-        int p[2];
-        //return error if failure
-        if (pipe(p) == -1) {
-            perror("pipe");
-            exit(1);
-        }
+        //the pipeline only takes over the terminal if the shell is in the foreground
+        int foreground = isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
 
-        // Create child 1 for first process
-        pid_t pid1 = fork();
-        if (pid1 == -1) {
-            perror("fork");
-            exit(1);
-        } else if (pid1 == 0) {
-            // Close read end of the pipe
-            close(p[0]); 
-            //redirect output to the write end
-            dup2(p[1], STDOUT_FILENO); 
-            //close the write end to ensure no leaks
-            close(p[1]);
-            //set pipe token to null so execv stops when it reaches the first null token
-            tokens[pipe_index] = NULL;
-            // Execute the first command
-            execute_command(tokens);
-            wait(NULL); 
-            exit(0); 
-        } else {
-            // Create the second process if first process is completed
-            pid_t pid2 = fork();
-            if (pid2 == -1) {
+        // All stages share one process group (led by the first stage) so the terminal can be handed to them together
+        pid_t pids[MAX_TOKENS];
+        pid_t pgid = 0;
+        int spawned = 0;
+        //read end of the pipe coming from the previous stage
+        int input_fd = -1;
+        //stages that exit through exit() would write out the shell's pending output again
+        fflush(stdout);
+        for (int i = 0; i < stage_count; i++) {
+            int p[2] = {-1, -1};
+            if (i < stage_count - 1 && pipe(p) == -1) {
+                perror("pipe");
+                break;
+            }
+
+            pid_t pid = fork();
+            if (pid == -1) {
                 perror("fork");
-                exit(1);
-            } else if (pid2 == 0) {
-                // Close write end of the pipe
-                close(p[1]); 
-                //redirect input to the read end
-                dup2(p[0], STDIN_FILENO); 
-                 //close the read end to ensure no leaks
-                close(p[0]); 
-
-                // Execute second command
-                execute_command(tokens + pipe_index + 1);
-                wait(NULL); 
-                exit(0); 
-            } else {
-                // Parent process
-                close(p[0]); 
+                if (p[0] != -1) {
+                    close(p[0]);
+                    close(p[1]);
+                }
+                break;
+            } else if (pid == 0) {
+                setpgid(0, pgid);
+                if (foreground) {
+                    give_terminal(getpgrp());
+                }
+                //redirect input to the read end of the previous pipe
+                if (input_fd != -1) {
+                    dup2(input_fd, STDIN_FILENO);
+                    close(input_fd);
+                }
+                //redirect output to the write end and close both ends to ensure no leaks
+                if (p[1] != -1) {
+                    close(p[0]);
+                    dup2(p[1], STDOUT_FILENO);
+                    close(p[1]);
+                }
+                exec_stage(stages[i]);
+            }
+
+            // Parent process, also sets the group so it exists before any stage runs
+            if (pgid == 0) {
+                pgid = pid;
+                if (foreground) {
+                    give_terminal(pgid);
+                }
+            }
+            setpgid(pid, pgid);
+            pids[spawned] = pid;
+            spawned++;
+
+            if (input_fd != -1) {
+                close(input_fd);
+            }
+            if (p[1] != -1) {
                 close(p[1]);
-                // Wait for both children to finish
-                wait(NULL); 
-                wait(NULL);
+            }
+            input_fd = p[0];
+        }
+        if (input_fd != -1) {
+            close(input_fd);
+        }
+
+        if (spawned > 0) {
+            // The pipeline is over when its last stage exits
+            int status;
+            int reaped = 0;
+            int stopped = 0;
+            if (spawned == stage_count) {
+                waitpid(pids[spawned - 1], &status, WUNTRACED);
+                if (WIFSTOPPED(status)) {
+                    stopped = 1;
+                } else {
+                    reaped = 1;
+                }
+            }
+
+            if (stopped) {
+                //Ctrl-Z stopped the pipeline, and since mysh has no job control to resume it later,
+                //take the terminal back and kill it rather than waiting on stages that never exit
+                if (foreground) {
+                    give_terminal(getpgrp());
+                }
+                kill(-pgid, SIGKILL);
+            } else {
+                //tear down producers that are still running (e.g. yes | head -1) instead of
+                //waiting for them to write into the closed pipe; the whole group is signalled so
+                //processes a stage started (like the command under memo) go too, and the first
+                //stage is still unreaped, which keeps the group alive
+                //stages with > ignore SIGPIPE (see exec_stage), so they are left to finish
+                kill(-pgid, SIGPIPE);
+            }
+
+            // Reap the rest so no zombies are left behind, killing any stage that stops on its own
+            for (int i = 0; i < spawned - reaped; i++) {
+                while (waitpid(pids[i], &status, WUNTRACED) > 0 && WIFSTOPPED(status)) {
+                    kill(pids[i], SIGKILL);
+                }
+            }
+            if (foreground) {
+                give_terminal(getpgrp());
             }
         }
+        currstatus = (spawned == stage_count);
     }
     dup2(original_stdout, STDOUT_FILENO);
     dup2(original_stdin, STDIN_FILENO);
@@ -0,0 +1,7 @@
+yes | head -1
+cat /dev/zero | head -c 1000000 | wc -c
+sleep 5 | echo hi
+seq 1 100000 > test/pipetest_output | true
+sort < test/input | uniq
+ls test | grep .txt
+sleep 0.4